@@ -11,5 +11,8 @@ public class DataDrivenGAS : ModuleRules
 		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "HeadMountedDisplay",
                     "GameplayAbilities", "GameplayTags","GameplayTasks"                                                                     //GAS combat modules
 		});
+
+		// damage formula coefficients, read by UDDG_DamageExecution when no imported table is set
+		RuntimeDependencies.Add("$(ProjectDir)/Raw/DamageCoefficients.csv", StagedFileType.UFS);
 	}
 }
@@ -1,7 +1,26 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "DataDrivenGAS.h"
+#include "CoreGlobals.h"
 #include "Modules/ModuleManager.h"
+#include "System/DDG_CombatJournal.h"
 
-IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, DataDrivenGAS, "DataDrivenGAS" );
- 
\ No newline at end of file
+class FDataDrivenGASModule : public FDefaultGameModuleImpl
+{
+public:
+	virtual void StartupModule() override
+	{
+		// commandlets (e.g. decoding a journal) should not record one
+		if (!IsRunningCommandlet())
+		{
+			FDDG_CombatJournal::Startup();
+		}
+	}
+
+	virtual void ShutdownModule() override
+	{
+		FDDG_CombatJournal::Shutdown();
+	}
+};
+
+IMPLEMENT_PRIMARY_GAME_MODULE( FDataDrivenGASModule, DataDrivenGAS, "DataDrivenGAS" );
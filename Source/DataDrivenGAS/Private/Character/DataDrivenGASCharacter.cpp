@@ -10,6 +10,7 @@
 #include "GameFramework/SpringArmComponent.h"
 #include "Combat/DDG_AbilitySystemComp.h"
 #include "Combat/DDG_AttributeSet.h"
+#include "System/DDG_CombatJournal.h"
 #include "GameplayEffect.h"
 #include "Kismet/GameplayStatics.h"
 
@@ -102,7 +103,7 @@ void ADataDrivenGASCharacter::ApplyLevelAttributes()
 
 	
 
-	UGameplayEffect* LevelUp_GameplayEffect = NewObject<UGameplayEffect>(GetTransientPackage(), TEXT("RuntimeInstanceGE"));
+	UGameplayEffect* LevelUp_GameplayEffect = AbilitySystemComp->CreateRuntimeGameplayEffect(TEXT("RuntimeInstanceGE"));	//tracked for effect memory accounting
 	LevelUp_GameplayEffect->DurationPolicy = EGameplayEffectDurationType::Instant;		//only instance works with runtime GE
 
 
@@ -119,8 +120,10 @@ void ADataDrivenGASCharacter::ApplyLevelAttributes()
 	BuildLevelUpMods(LevelUp_GameplayEffect, RowMap, UDDG_AttributeSet::GetManaRegenRateAttribute());
 		
 
-	FGameplayEffectSpec* GESpec = new FGameplayEffectSpec(LevelUp_GameplayEffect, {}, 0.f); // "new", since lifetime is managed by a shared ptr within the handle
-	FActiveGameplayEffectHandle ActiveGEHandle = AbilitySystemComp->ApplyGameplayEffectSpecToTarget(*GESpec, AbilitySystemComp);
+	const FGameplayEffectSpec GESpec(LevelUp_GameplayEffect, {}, 0.f); // applying copies the spec, so it can live on the stack
+	FActiveGameplayEffectHandle ActiveGEHandle = AbilitySystemComp->ApplyGameplayEffectSpecToTarget(GESpec, AbilitySystemComp);
+
+	FDDG_CombatJournal::Record(EDDG_JournalEvent::LevelUp, EDDG_JournalAttribute::CharacterLevel, this, nullptr, 0.f, static_cast<float>(GetCharacterLevel()));
 
 	UE_LOG(LogTemp, Log, TEXT("Level stats added for : %s"), *GetName());
 
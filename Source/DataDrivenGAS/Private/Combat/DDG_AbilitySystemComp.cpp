@@ -2,4 +2,207 @@
 
 
 #include "Combat/DDG_AbilitySystemComp.h"
+#include "GameplayEffect.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "TimerManager.h"
+#include "UObject/Package.h"
+#include "UObject/UnrealType.h"
+#include "UObject/UObjectIterator.h"
 
+static TAutoConsoleVariable<float> CVarEffectMemoryCheckInterval(
+	TEXT("DDG.Effects.MemoryCheckInterval"),
+	30.f,
+	TEXT("Seconds between gameplay effect memory checks on each ability system component, 0 disables them. Read on BeginPlay."));
+
+static TAutoConsoleVariable<int32> CVarEffectMemoryBudgetPerASC(
+	TEXT("DDG.Effects.MemoryBudgetPerASC"),
+	64,
+	TEXT("Gameplay effect memory budget per ability system component in KB, a warning is logged when a memory check finds it above it. 0 disables the check."));
+
+static TAutoConsoleVariable<int32> CVarEffectMemoryBudgetGlobal(
+	TEXT("DDG.Effects.MemoryBudgetGlobal"),
+	64 * 1024,
+	TEXT("Gameplay effect memory budget for all ability system components in KB, summed at most once per DDG.Effects.MemoryCheckInterval by the periodic checks. ")
+	TEXT("With the interval at 0 it is only checked by DDG.Effects.CheckMemory. 0 disables the check."));
+
+static FAutoConsoleCommand DumpEffectMemoryCommand(
+	TEXT("DDG.Effects.DumpMemory"),
+	TEXT("Logs the estimated gameplay effect memory of every ability system component"),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		int32 NumComponents = 0;
+		SIZE_T TotalBytes = 0;
+		for (TObjectIterator<UDDG_AbilitySystemComp> It; It; ++It)
+		{
+			if (It->IsTemplate() || !It->HasBegunPlay())
+			{
+				continue;
+			}
+
+			const FDDG_EffectMemoryStats Stats = It->GetEffectMemoryStats();
+			UE_LOG(LogTemp, Log, TEXT("%s : %d active effects, %d runtime effects, %.1f KB (active %.1f KB, specs %.1f KB, runtime effects %.1f KB)"),
+				*GetNameSafe(It->GetOwner()), Stats.NumActiveEffects, Stats.NumRuntimeEffects, Stats.GetTotalBytes() / 1024.f,
+				Stats.ActiveEffectBytes / 1024.f, Stats.SpecBytes / 1024.f, Stats.RuntimeEffectBytes / 1024.f);
+
+			++NumComponents;
+			TotalBytes += Stats.GetTotalBytes();
+		}
+		UE_LOG(LogTemp, Log, TEXT("Gameplay effect memory : %.1f KB in %d ability system components"), TotalBytes / 1024.f, NumComponents);
+	}));
+
+static FAutoConsoleCommand CheckEffectMemoryCommand(
+	TEXT("DDG.Effects.CheckMemory"),
+	TEXT("Prunes the runtime effect tracking lists and checks the gameplay effect memory budgets of every ability system component now"),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		for (TObjectIterator<UDDG_AbilitySystemComp> It; It; ++It)
+		{
+			if (!It->IsTemplate() && It->HasBegunPlay() && It->IsOwnerActorAuthoritative())
+			{
+				It->CheckEffectMemory();
+			}
+		}
+		UDDG_AbilitySystemComp::CheckGlobalEffectMemory();
+	}));
+
+// time of the last global budget check, only touched on the game thread
+static double GLastGlobalEffectMemoryCheckSeconds = 0.0;
+
+static SIZE_T GetActiveEffectsContainerBytes(const FActiveGameplayEffectsContainer& Container)
+{
+	// the effect array is private to GAS, its allocation (slack included) is read through reflection
+	static const FArrayProperty* EffectsProperty = FindFProperty<FArrayProperty>(FActiveGameplayEffectsContainer::StaticStruct(), TEXT("GameplayEffects_Internal"));
+	if (!EffectsProperty)
+	{
+		return Container.GetNumGameplayEffects() * sizeof(FActiveGameplayEffect);
+	}
+	return EffectsProperty->ContainerPtrToValuePtr<FScriptArray>(&Container)->GetAllocatedSize(EffectsProperty->Inner->ElementSize);
+}
+
+static SIZE_T GetSpecAllocatedBytes(const FGameplayEffectSpec& Spec)
+{
+	return Spec.Modifiers.GetAllocatedSize()
+		+ Spec.TargetEffectSpecs.GetAllocatedSize()
+		+ Spec.GrantedAbilitySpecs.GetAllocatedSize()
+		+ Spec.SetByCallerNameMagnitudes.GetAllocatedSize()
+		+ Spec.SetByCallerTagMagnitudes.GetAllocatedSize()
+		+ (Spec.DynamicGrantedTags.Num() + Spec.DynamicAssetTags.Num()) * sizeof(FGameplayTag);
+}
+
+static SIZE_T GetRuntimeEffectBytes(const UGameplayEffect* Effect)
+{
+	return Effect->GetClass()->GetPropertiesSize()
+		+ Effect->Modifiers.GetAllocatedSize()
+		+ Effect->Executions.GetAllocatedSize()
+		+ Effect->ConditionalGameplayEffects.GetAllocatedSize();
+}
+
+UGameplayEffect* UDDG_AbilitySystemComp::CreateRuntimeGameplayEffect(FName BaseName)
+{
+	// unique name so a new effect never replaces one that is still referenced by a spec
+	const FName EffectName = MakeUniqueObjectName(GetTransientPackage(), UGameplayEffect::StaticClass(), BaseName);
+	UGameplayEffect* RuntimeEffect = NewObject<UGameplayEffect>(GetTransientPackage(), EffectName);
+	RuntimeEffects.Add(RuntimeEffect);
+	return RuntimeEffect;
+}
+
+FDDG_EffectMemoryStats UDDG_AbilitySystemComp::GetEffectMemoryStats() const
+{
+	FDDG_EffectMemoryStats Stats;
+	Stats.ActiveEffectBytes = GetActiveEffectsContainerBytes(ActiveGameplayEffects);
+
+	for (const FActiveGameplayEffect& ActiveEffect : &ActiveGameplayEffects)
+	{
+		++Stats.NumActiveEffects;
+		Stats.SpecBytes += GetSpecAllocatedBytes(ActiveEffect.Spec);
+	}
+
+	for (const TWeakObjectPtr<UGameplayEffect>& RuntimeEffect : RuntimeEffects)
+	{
+		if (const UGameplayEffect* Effect = RuntimeEffect.Get())
+		{
+			++Stats.NumRuntimeEffects;
+			Stats.RuntimeEffectBytes += GetRuntimeEffectBytes(Effect);
+		}
+	}
+	Stats.RuntimeEffectBytes += RuntimeEffects.GetAllocatedSize();
+
+	return Stats;
+}
+
+void UDDG_AbilitySystemComp::CheckEffectMemory()
+{
+	RuntimeEffects.RemoveAll([](const TWeakObjectPtr<UGameplayEffect>& RuntimeEffect)
+	{
+		return !RuntimeEffect.IsValid();
+	});
+	RuntimeEffects.Shrink();
+
+	const FDDG_EffectMemoryStats Stats = GetEffectMemoryStats();
+
+	const SIZE_T BudgetPerASC = static_cast<SIZE_T>(FMath::Max(CVarEffectMemoryBudgetPerASC.GetValueOnGameThread(), 0)) * 1024;
+	if (BudgetPerASC > 0 && Stats.GetTotalBytes() > BudgetPerASC)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s() %s uses %.1f KB of gameplay effect memory (%d active effects), over the %.1f KB budget"),
+			*FString(__FUNCTION__), *GetNameSafe(GetOwner()), Stats.GetTotalBytes() / 1024.f, Stats.NumActiveEffects, BudgetPerASC / 1024.f);
+	}
+
+	// one pass over every component instead of one per timer, so the total is never a mix of old readings
+	if (FPlatformTime::Seconds() - GLastGlobalEffectMemoryCheckSeconds >= CVarEffectMemoryCheckInterval.GetValueOnGameThread())
+	{
+		CheckGlobalEffectMemory();
+	}
+}
+
+SIZE_T UDDG_AbilitySystemComp::GetGlobalEffectMemoryBytes()
+{
+	SIZE_T TotalBytes = 0;
+	for (TObjectIterator<UDDG_AbilitySystemComp> It; It; ++It)
+	{
+		if (!It->IsTemplate() && It->HasBegunPlay())
+		{
+			TotalBytes += It->GetEffectMemoryStats().GetTotalBytes();
+		}
+	}
+	return TotalBytes;
+}
+
+void UDDG_AbilitySystemComp::CheckGlobalEffectMemory()
+{
+	GLastGlobalEffectMemoryCheckSeconds = FPlatformTime::Seconds();
+
+	const SIZE_T GlobalBudget = static_cast<SIZE_T>(FMath::Max(CVarEffectMemoryBudgetGlobal.GetValueOnGameThread(), 0)) * 1024;
+	if (GlobalBudget == 0)
+	{
+		return;
+	}
+
+	const SIZE_T GlobalBytes = GetGlobalEffectMemoryBytes();
+	if (GlobalBytes > GlobalBudget)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s() Gameplay effect memory is %.1f KB, over the %.1f KB global budget"),
+			*FString(__FUNCTION__), GlobalBytes / 1024.f, GlobalBudget / 1024.f);
+	}
+}
+
+void UDDG_AbilitySystemComp::BeginPlay()
+{
+	Super::BeginPlay();
+
+	const float MemoryCheckInterval = CVarEffectMemoryCheckInterval.GetValueOnGameThread();
+	if (MemoryCheckInterval > 0.f && IsOwnerActorAuthoritative() && GetWorld())
+	{
+		GetWorld()->GetTimerManager().SetTimer(MemoryCheckTimerHandle, this, &UDDG_AbilitySystemComp::CheckEffectMemory, MemoryCheckInterval, true);
+	}
+}
+
+void UDDG_AbilitySystemComp::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (GetWorld())
+	{
+		GetWorld()->GetTimerManager().ClearTimer(MemoryCheckTimerHandle);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
@@ -2,6 +2,8 @@
 
 
 #include "Combat/DDG_AttributeSet.h"
+#include "Combat/DDG_CombatRules.h"
+#include "System/DDG_CombatJournal.h"
 #include "GameplayEffect.h"
 #include "Character/DataDrivenGASCharacter.h"
 #include "GameplayEffectExtension.h"
@@ -10,6 +12,20 @@
 
 
 
+// maps an attribute to its compact combat journal id
+static EDDG_JournalAttribute ToJournalAttribute(const FGameplayAttribute& Attribute)
+{
+	if (Attribute == UDDG_AttributeSet::GetHealthAttribute())				return EDDG_JournalAttribute::Health;
+	if (Attribute == UDDG_AttributeSet::GetMaxHealthAttribute())			return EDDG_JournalAttribute::MaxHealth;
+	if (Attribute == UDDG_AttributeSet::GetHealthRegenRateAttribute())		return EDDG_JournalAttribute::HealthRegenRate;
+	if (Attribute == UDDG_AttributeSet::GetManaAttribute())					return EDDG_JournalAttribute::Mana;
+	if (Attribute == UDDG_AttributeSet::GetMaxManaAttribute())				return EDDG_JournalAttribute::MaxMana;
+	if (Attribute == UDDG_AttributeSet::GetManaRegenRateAttribute())		return EDDG_JournalAttribute::ManaRegenRate;
+	if (Attribute == UDDG_AttributeSet::GetCharacterLevelAttribute())		return EDDG_JournalAttribute::CharacterLevel;
+	if (Attribute == UDDG_AttributeSet::GetDamageAttribute())				return EDDG_JournalAttribute::Damage;
+	return EDDG_JournalAttribute::None;
+}
+
 UDDG_AttributeSet::UDDG_AttributeSet()
 	:CharacterLevel(1.0f)
 {
@@ -44,6 +60,8 @@ void UDDG_AttributeSet::PreAttributeChange(const FGameplayAttribute& Attribute,
 	// This is called whenever attributes change, so for max health/mana we want to scale the current totals to match
 	Super::PreAttributeChange(Attribute, NewValue);
 
+	FDDG_CombatJournal::Record(EDDG_JournalEvent::AttributeChange, ToJournalAttribute(Attribute), GetOwningActor(), nullptr, Attribute.GetNumericValue(this), NewValue);
+
 	// If a Max value changes, adjust current to keep Current % of Current to Max
 	if (Attribute == GetMaxHealthAttribute()) // GetMaxHealthAttribute comes from the Macros defined at the top of the header
 	{
@@ -132,22 +150,24 @@ void UDDG_AttributeSet::PostGameplayEffectExecute(const FGameplayEffectModCallba
 
 			if (!TargetCharacter->IsAlive())
 			{
+				FDDG_CombatJournal::Record(EDDG_JournalEvent::DamageIgnoredDead, EDDG_JournalAttribute::Health, TargetCharacter, SourceActor, GetHealth(), LocalDamageDone);
 				UE_LOG(LogTemp, Warning, TEXT("%s() %s is NOT alive when receiving damage"), TEXT(__FUNCTION__), *TargetCharacter->GetName());
 				return;
 			}
 
-			//check if damage would kill if it's greater than current health
-			if (LocalDamageDone >= GetHealth())
+			// same damage/death rules as the crowd combat fragments
+			float NewHealth = GetHealth();
+			float NewMana = GetMana();
+			const bool bKilled = DDGCombatRules::ApplyDamage(LocalDamageDone, NewHealth, NewMana, GetMaxHealth());
+			SetHealth(NewHealth);
+			FDDG_CombatJournal::Record(EDDG_JournalEvent::Damage, EDDG_JournalAttribute::Health, TargetCharacter, SourceActor, LocalDamageDone, NewHealth);
+
+			if (bKilled)
 			{
-				SetHealth(0.0f);
-				SetMana(0.0f);
+				SetMana(NewMana);
 
 				ApplyDeathToTarget(TargetCharacter);
-			}
-			else {
-				// Apply the health change and then clamp it
-				const float NewHealth = GetHealth() - LocalDamageDone;
-				SetHealth(FMath::Clamp(NewHealth, 0.0f, GetMaxHealth()));
+				FDDG_CombatJournal::Record(EDDG_JournalEvent::Death, EDDG_JournalAttribute::None, TargetCharacter, SourceActor, LocalDamageDone, 0.f);
 			}
 
 			if (WasAlive)
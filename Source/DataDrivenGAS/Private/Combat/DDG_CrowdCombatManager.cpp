@@ -0,0 +1,369 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Combat/DDG_CrowdCombatManager.h"
+#include "Combat/DDG_CombatRules.h"
+#include "Combat/DDG_AttributeSet.h"
+#include "Character/DataDrivenGASCharacter.h"
+#include "Async/ParallelFor.h"
+#include "Engine/CurveTable.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "UObject/ConstructorHelpers.h"
+
+
+
+ADDG_CrowdCombatManager::ADDG_CrowdCombatManager()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = true;
+
+	PromotedCharacterClass = ADataDrivenGASCharacter::StaticClass();
+
+	// load the data driven level curve stats, same table as the characters
+	ConstructorHelpers::FObjectFinder<UCurveTable> LevelStatsTable_BP_Reference(TEXT("/Game/Assets/Data/CharacterStats.CharacterStats"));
+	StatsTable = LevelStatsTable_BP_Reference.Object;
+}
+
+FDDG_CrowdEntityHandle ADDG_CrowdCombatManager::SpawnCrowdEntity(const FString& CharacterName, int32 Level, const FVector& Location)
+{
+	FDDG_CrowdEntityHandle Handle;
+
+	if (!HasAuthority())
+	{
+		return Handle;
+	}
+
+	const int32 StatBlockIndex = FindOrAddStatBlock(CharacterName, Level);
+	if (StatBlockIndex == INDEX_NONE)
+	{
+		return Handle;
+	}
+
+	int32 EntityIndex;
+	if (FreeIndices.Num() > 0)
+	{
+		EntityIndex = FreeIndices.Pop(false);
+	}
+	else
+	{
+		EntityIndex = Attributes.AddDefaulted();
+		Locations.AddUninitialized();
+		StatBlockIndices.AddUninitialized();
+		Serials.Add(0);
+		Flags.Add(0);
+	}
+
+	Attributes[EntityIndex] = FDDG_CrowdAttributeFragment();
+	Locations[EntityIndex] = Location;
+	Flags[EntityIndex] = Flag_Active;
+	ApplyStatBlock(EntityIndex, StatBlockIndex);
+	++NumActiveEntities;
+
+	Handle.Index = EntityIndex;
+	Handle.Serial = Serials[EntityIndex];
+	return Handle;
+}
+
+void ADDG_CrowdCombatManager::DestroyCrowdEntity(FDDG_CrowdEntityHandle Entity)
+{
+	if (IsValidHandle(Entity))
+	{
+		ReleaseEntity(Entity.Index);
+	}
+}
+
+void ADDG_CrowdCombatManager::ApplyDamageToCrowdEntity(FDDG_CrowdEntityHandle Entity, float Damage)
+{
+	if (IsValidHandle(Entity) && Damage > 0.f)
+	{
+		Attributes[Entity.Index].PendingDamage += Damage;
+	}
+}
+
+void ADDG_CrowdCombatManager::SetCrowdEntityLevel(FDDG_CrowdEntityHandle Entity, int32 NewLevel)
+{
+	if (!IsValidHandle(Entity))
+	{
+		return;
+	}
+
+	const int32 StatBlockIndex = FindOrAddStatBlock(StatBlocks[StatBlockIndices[Entity.Index]].CharacterName, NewLevel);
+	if (StatBlockIndex != INDEX_NONE)
+	{
+		ApplyStatBlock(Entity.Index, StatBlockIndex);
+	}
+}
+
+void ADDG_CrowdCombatManager::SetCrowdEntityLocation(FDDG_CrowdEntityHandle Entity, const FVector& NewLocation)
+{
+	if (IsValidHandle(Entity))
+	{
+		Locations[Entity.Index] = NewLocation;
+	}
+}
+
+bool ADDG_CrowdCombatManager::IsCrowdEntityAlive(FDDG_CrowdEntityHandle Entity) const
+{
+	return IsValidHandle(Entity) && !(Flags[Entity.Index] & Flag_Dead);
+}
+
+const FDDG_CrowdAttributeFragment* ADDG_CrowdCombatManager::GetAttributes(FDDG_CrowdEntityHandle Entity) const
+{
+	return IsValidHandle(Entity) ? &Attributes[Entity.Index] : nullptr;
+}
+
+ADataDrivenGASCharacter* ADDG_CrowdCombatManager::PromoteCrowdEntity(FDDG_CrowdEntityHandle Entity)
+{
+	if (!IsValidHandle(Entity) || (Flags[Entity.Index] & Flag_Dead))
+	{
+		return nullptr;
+	}
+
+	if (!PromotedCharacterClass)
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s() Missing PromotedCharacterClass in %s"), *FString(__FUNCTION__), *GetName());
+		return nullptr;
+	}
+
+	const FDDG_CrowdAttributeFragment& Fragment = Attributes[Entity.Index];
+	const FDDG_CrowdStatBlock& StatBlock = StatBlocks[StatBlockIndices[Entity.Index]];
+
+	const FTransform SpawnTransform(Locations[Entity.Index]);
+	ADataDrivenGASCharacter* Character = GetWorld()->SpawnActorDeferred<ADataDrivenGASCharacter>(PromotedCharacterClass, SpawnTransform, nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn);
+	if (!Character)
+	{
+		return nullptr;
+	}
+
+	Character->CharacterName = StatBlock.CharacterName;
+	Character->FinishSpawning(SpawnTransform);
+
+	// level stats go through the regular GAS path, then the current values carry over from the crowd
+	Character->AttributeSetBaseComp->SetCharacterLevel(Fragment.CharacterLevel);
+	Character->ApplyLevelAttributes();
+	Character->AttributeSetBaseComp->SetHealth(Fragment.Health);
+	Character->AttributeSetBaseComp->SetMana(Fragment.Mana);
+
+	ReleaseEntity(Entity.Index);
+	OnCrowdEntityPromoted.Broadcast(Entity, Character);
+
+	UE_LOG(LogTemp, Log, TEXT("Crowd entity %d promoted to : %s"), Entity.Index, *Character->GetName());
+	return Character;
+}
+
+void ADDG_CrowdCombatManager::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (!HasAuthority() || NumActiveEntities == 0)
+	{
+		return;
+	}
+
+	RunDamageSystem();
+
+	// deaths are reported on the game thread once the parallel pass is done
+	for (int32 EntityIndex = 0; EntityIndex < Flags.Num(); ++EntityIndex)
+	{
+		if (Flags[EntityIndex] & Flag_JustDied)
+		{
+			Flags[EntityIndex] &= ~Flag_JustDied;
+
+			FDDG_CrowdEntityHandle Handle;
+			Handle.Index = EntityIndex;
+			Handle.Serial = Serials[EntityIndex];
+			OnCrowdEntityDied.Broadcast(Handle);
+		}
+	}
+
+	PlayerLocations.Reset();
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PlayerController = It->Get();
+		if (PlayerController && PlayerController->GetPawn())
+		{
+			PlayerLocations.Add(PlayerController->GetPawn()->GetActorLocation());
+		}
+	}
+
+	if (PlayerLocations.Num() == 0)
+	{
+		return;
+	}
+
+	RunPromotionSystem();
+
+	int32 NumPromoted = 0;
+	for (int32 EntityIndex = 0; EntityIndex < Flags.Num() && NumPromoted < MaxPromotionsPerTick; ++EntityIndex)
+	{
+		if (Flags[EntityIndex] & Flag_WantsPromotion)
+		{
+			FDDG_CrowdEntityHandle Handle;
+			Handle.Index = EntityIndex;
+			Handle.Serial = Serials[EntityIndex];
+			if (PromoteCrowdEntity(Handle))
+			{
+				++NumPromoted;
+			}
+			else
+			{
+				// not retried until the entity leaves and re-enters promotion range
+				Flags[EntityIndex] &= ~Flag_WantsPromotion;
+				Flags[EntityIndex] |= Flag_PromotionFailed;
+			}
+		}
+	}
+}
+
+bool ADDG_CrowdCombatManager::IsValidHandle(FDDG_CrowdEntityHandle Entity) const
+{
+	return Flags.IsValidIndex(Entity.Index) && (Flags[Entity.Index] & Flag_Active) && Serials[Entity.Index] == Entity.Serial;
+}
+
+int32 ADDG_CrowdCombatManager::FindOrAddStatBlock(const FString& CharacterName, int32 Level)
+{
+	const FName LookupName(*FString::Printf(TEXT("%s.%d"), *CharacterName, Level));
+	if (const int32* FoundIndex = StatBlockLookup.Find(LookupName))
+	{
+		return *FoundIndex;
+	}
+
+	if (!StatsTable)
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s() Missing Level Stats table for %s. Please fill in the StatsTable."), *FString(__FUNCTION__), *GetName());
+		return INDEX_NONE;
+	}
+
+	FDDG_CrowdStatBlock StatBlock;
+	StatBlock.CharacterName = CharacterName;
+	StatBlock.Level = Level;
+	StatBlock.MaxHealth = ReadLevelStat(CharacterName, Level, UDDG_AttributeSet::GetMaxHealthAttribute());
+	StatBlock.HealthRegenRate = ReadLevelStat(CharacterName, Level, UDDG_AttributeSet::GetHealthRegenRateAttribute());
+	StatBlock.MaxMana = ReadLevelStat(CharacterName, Level, UDDG_AttributeSet::GetMaxManaAttribute());
+	StatBlock.ManaRegenRate = ReadLevelStat(CharacterName, Level, UDDG_AttributeSet::GetManaRegenRateAttribute());
+
+	const int32 StatBlockIndex = StatBlocks.Add(StatBlock);
+	StatBlockLookup.Add(LookupName, StatBlockIndex);
+	return StatBlockIndex;
+}
+
+float ADDG_CrowdCombatManager::ReadLevelStat(const FString& CharacterName, int32 Level, const FGameplayAttribute& Attribute) const
+{
+	// same row naming as ADataDrivenGASCharacter::BuildLevelUpMods
+	FString searchedRowString = CharacterName + "." + Attribute.GetName();
+	if (FRealCurve* foundRowCurve = StatsTable->GetRowMap().FindRef(FName(*searchedRowString)))
+	{
+		FKeyHandle eachKeyHandle = foundRowCurve->FindKey(Level);
+		return foundRowCurve->GetKeyValue(eachKeyHandle);
+	}
+
+	UE_LOG(LogTemp, Error, TEXT("%s() Warning could not find level up stats for %s. Please fill in the character's levelup datatable."), *FString(__FUNCTION__), *searchedRowString);
+	return 0.f;
+}
+
+void ADDG_CrowdCombatManager::ApplyStatBlock(int32 EntityIndex, int32 StatBlockIndex)
+{
+	const FDDG_CrowdStatBlock& StatBlock = StatBlocks[StatBlockIndex];
+	FDDG_CrowdAttributeFragment& Fragment = Attributes[EntityIndex];
+
+	StatBlockIndices[EntityIndex] = StatBlockIndex;
+	Fragment.CharacterLevel = StatBlock.Level;
+	Fragment.HealthRegenRate = StatBlock.HealthRegenRate;
+	Fragment.ManaRegenRate = StatBlock.ManaRegenRate;
+
+	Fragment.MaxHealth = StatBlock.MaxHealth;
+	Fragment.MaxMana = StatBlock.MaxMana;
+
+	// the level up effect refills health/mana to the new max, same as PostGameplayEffectExecute on a max change
+	Fragment.Health = Fragment.MaxHealth;
+	Fragment.Mana = Fragment.MaxMana;
+}
+
+void ADDG_CrowdCombatManager::RunDamageSystem()
+{
+	const int32 NumEntities = Attributes.Num();
+	const int32 ChunkSize = FMath::Max(EntitiesPerTask, 1);
+	const int32 NumChunks = FMath::DivideAndRoundUp(NumEntities, ChunkSize);
+
+	// each chunk only touches its own entities so no locking is needed
+	ParallelFor(NumChunks, [this, NumEntities, ChunkSize](int32 ChunkIndex)
+	{
+		const int32 Start = ChunkIndex * ChunkSize;
+		const int32 End = FMath::Min(Start + ChunkSize, NumEntities);
+		for (int32 EntityIndex = Start; EntityIndex < End; ++EntityIndex)
+		{
+			FDDG_CrowdAttributeFragment& Fragment = Attributes[EntityIndex];
+			const float LocalDamageDone = Fragment.PendingDamage;
+			if (LocalDamageDone <= 0.f)
+			{
+				continue;
+			}
+			Fragment.PendingDamage = 0.f;
+
+			// dead or free slots ignore damage, same as a dead character
+			uint8& EntityFlags = Flags[EntityIndex];
+			if ((EntityFlags & (Flag_Active | Flag_Dead)) != Flag_Active)
+			{
+				continue;
+			}
+
+			if (DDGCombatRules::ApplyDamage(LocalDamageDone, Fragment.Health, Fragment.Mana, Fragment.MaxHealth))
+			{
+				EntityFlags |= Flag_Dead | Flag_JustDied;
+				EntityFlags &= ~Flag_WantsPromotion;
+			}
+		}
+	});
+}
+
+void ADDG_CrowdCombatManager::RunPromotionSystem()
+{
+	const int32 NumEntities = Attributes.Num();
+	const int32 ChunkSize = FMath::Max(EntitiesPerTask, 1);
+	const int32 NumChunks = FMath::DivideAndRoundUp(NumEntities, ChunkSize);
+	const float PromotionRadiusSq = FMath::Square(PromotionRadius);
+
+	ParallelFor(NumChunks, [this, NumEntities, ChunkSize, PromotionRadiusSq](int32 ChunkIndex)
+	{
+		const int32 Start = ChunkIndex * ChunkSize;
+		const int32 End = FMath::Min(Start + ChunkSize, NumEntities);
+		for (int32 EntityIndex = Start; EntityIndex < End; ++EntityIndex)
+		{
+			uint8& EntityFlags = Flags[EntityIndex];
+			if ((EntityFlags & (Flag_Active | Flag_Dead)) != Flag_Active)
+			{
+				continue;
+			}
+
+			bool bInRange = false;
+			const FVector& Location = Locations[EntityIndex];
+			for (const FVector& PlayerLocation : PlayerLocations)
+			{
+				if (FVector::DistSquared(Location, PlayerLocation) <= PromotionRadiusSq)
+				{
+					bInRange = true;
+					break;
+				}
+			}
+
+			// recomputed every pass so entities left over from MaxPromotionsPerTick drop out once players move away
+			if (!bInRange)
+			{
+				EntityFlags &= ~(Flag_WantsPromotion | Flag_PromotionFailed);
+			}
+			else if (!(EntityFlags & Flag_PromotionFailed))
+			{
+				EntityFlags |= Flag_WantsPromotion;
+			}
+		}
+	});
+}
+
+void ADDG_CrowdCombatManager::ReleaseEntity(int32 EntityIndex)
+{
+	Flags[EntityIndex] = 0;
+	++Serials[EntityIndex];
+	FreeIndices.Add(EntityIndex);
+	--NumActiveEntities;
+}
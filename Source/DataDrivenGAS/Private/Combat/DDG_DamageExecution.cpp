@@ -0,0 +1,142 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Combat/DDG_DamageExecution.h"
+#include "Combat/DDG_AttributeSet.h"
+#include "AbilitySystemComponent.h"
+#include "Engine/CurveTable.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/Package.h"
+
+// Capture definitions are built once and shared by every execution
+struct FDDG_DamageStatics
+{
+	FGameplayEffectAttributeCaptureDefinition SourceLevelDef;
+	FGameplayEffectAttributeCaptureDefinition TargetLevelDef;
+	FGameplayEffectAttributeCaptureDefinition TargetHealthDef;
+	FGameplayEffectAttributeCaptureDefinition TargetMaxHealthDef;
+
+	FDDG_DamageStatics()
+		: SourceLevelDef(UDDG_AttributeSet::GetCharacterLevelAttribute(), EGameplayEffectAttributeCaptureSource::Source, true)
+		, TargetLevelDef(UDDG_AttributeSet::GetCharacterLevelAttribute(), EGameplayEffectAttributeCaptureSource::Target, false)
+		, TargetHealthDef(UDDG_AttributeSet::GetHealthAttribute(), EGameplayEffectAttributeCaptureSource::Target, false)
+		, TargetMaxHealthDef(UDDG_AttributeSet::GetMaxHealthAttribute(), EGameplayEffectAttributeCaptureSource::Target, false)
+	{
+	}
+};
+
+static const FDDG_DamageStatics& DamageStatics()
+{
+	static FDDG_DamageStatics Statics;
+	return Statics;
+}
+
+static FAutoConsoleCommand RecompileDamageFormulaCommand(
+	TEXT("DDG.Damage.RecompileFormula"),
+	TEXT("Recompiles the damage execution formula from config and the damage coefficients table"),
+	FConsoleCommandDelegate::CreateStatic(&UDDG_DamageExecution::RecompileFormula));
+
+
+
+UDDG_DamageExecution::UDDG_DamageExecution()
+{
+	DamageFormula = TEXT("BaseDamage");
+	CoefficientsCsvPath = TEXT("Raw/DamageCoefficients.csv");
+
+	RelevantAttributesToCapture.Add(DamageStatics().SourceLevelDef);
+	RelevantAttributesToCapture.Add(DamageStatics().TargetLevelDef);
+	RelevantAttributesToCapture.Add(DamageStatics().TargetHealthDef);
+	RelevantAttributesToCapture.Add(DamageStatics().TargetMaxHealthDef);
+}
+
+void UDDG_DamageExecution::Execute_Implementation(const FGameplayEffectCustomExecutionParameters& ExecutionParams, FGameplayEffectCustomExecutionOutput& OutExecutionOutput) const
+{
+	static const FGameplayTag DamageDataTag = FGameplayTag::RequestGameplayTag(FName("Data.Damage"));
+
+	const FGameplayEffectSpec& Spec = ExecutionParams.GetOwningSpec();
+
+	FAggregatorEvaluateParameters EvaluationParameters;
+	EvaluationParameters.SourceTags = Spec.CapturedSourceTags.GetAggregatedTags();
+	EvaluationParameters.TargetTags = Spec.CapturedTargetTags.GetAggregatedTags();
+
+	FDDG_DamageFormulaInput Input;
+	Input.BaseDamage = Spec.GetSetByCallerMagnitude(DamageDataTag, false, 0.f);
+	ExecutionParams.AttemptCalculateCapturedAttributeMagnitude(DamageStatics().SourceLevelDef, EvaluationParameters, Input.SourceLevel);
+	ExecutionParams.AttemptCalculateCapturedAttributeMagnitude(DamageStatics().TargetLevelDef, EvaluationParameters, Input.TargetLevel);
+	ExecutionParams.AttemptCalculateCapturedAttributeMagnitude(DamageStatics().TargetHealthDef, EvaluationParameters, Input.TargetHealth);
+	ExecutionParams.AttemptCalculateCapturedAttributeMagnitude(DamageStatics().TargetMaxHealthDef, EvaluationParameters, Input.TargetMaxHealth);
+	Input.CritRoll = FMath::FRand();
+
+	const float DamageDone = GetCompiledFormula().Evaluate(Input);
+	if (DamageDone > 0.f)
+	{
+		// goes through the Damage meta attribute so PostGameplayEffectExecute keeps handling death
+		OutExecutionOutput.AddOutputModifier(FGameplayModifierEvaluatedData(UDDG_AttributeSet::GetDamageAttribute(), EGameplayModOp::Additive, DamageDone));
+	}
+}
+
+void UDDG_DamageExecution::PostInitProperties()
+{
+	Super::PostInitProperties();
+
+	// config is loaded by now, compile before anything (possibly a worker thread) evaluates the formula
+	if (HasAnyFlags(RF_ClassDefaultObject))
+	{
+		CompileFormula();
+	}
+}
+
+const FDDG_DamageFormula& UDDG_DamageExecution::GetCompiledFormula()
+{
+	const FDDG_DamageFormula& Formula = GetDefault<UDDG_DamageExecution>()->CompiledFormula;
+	check(Formula.IsCompiled());
+	return Formula;
+}
+
+void UDDG_DamageExecution::RecompileFormula()
+{
+	UDDG_DamageExecution* DefaultExecution = GetMutableDefault<UDDG_DamageExecution>();
+	DefaultExecution->ReloadConfig();
+	DefaultExecution->CompileFormula();
+}
+
+void UDDG_DamageExecution::CompileFormula()
+{
+	// coefficients are baked into the compiled formula, the table is not needed after this
+	CompiledFormula.Compile(DamageFormula, LoadCoefficientsTable());
+}
+
+const UCurveTable* UDDG_DamageExecution::LoadCoefficientsTable() const
+{
+	if (!CoefficientsTable.IsNull())
+	{
+		const UCurveTable* LoadedCoefficientsTable = CoefficientsTable.LoadSynchronous();
+		if (!LoadedCoefficientsTable)
+		{
+			UE_LOG(LogTemp, Error, TEXT("%s() Could not load damage coefficients table %s"), *FString(__FUNCTION__), *CoefficientsTable.ToString());
+		}
+		return LoadedCoefficientsTable;
+	}
+
+	if (CoefficientsCsvPath.IsEmpty())
+	{
+		return nullptr;
+	}
+
+	const FString CsvFilePath = FPaths::ProjectDir() / CoefficientsCsvPath;
+	FString CsvText;
+	if (!FFileHelper::LoadFileToString(CsvText, *CsvFilePath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s() Could not read damage coefficients %s"), *FString(__FUNCTION__), *CsvFilePath);
+		return nullptr;
+	}
+
+	UCurveTable* CsvTable = NewObject<UCurveTable>(GetTransientPackage(), NAME_None, RF_Transient);
+	for (const FString& Problem : CsvTable->CreateTableFromCSVString(CsvText))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s() %s : %s"), *FString(__FUNCTION__), *CsvFilePath, *Problem);
+	}
+	return CsvTable;
+}
@@ -0,0 +1,415 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Combat/DDG_DamageFormula.h"
+#include "Async/ParallelFor.h"
+#include "Curves/RealCurve.h"
+#include "Engine/CurveTable.h"
+
+namespace
+{
+	// variables always present, in the same order as FDDG_DamageFormulaInput
+	const TCHAR* const BuiltinVariableNames[] = { TEXT("BaseDamage"), TEXT("SourceLevel"), TEXT("TargetLevel"), TEXT("TargetHealth"), TEXT("TargetMaxHealth"), TEXT("CritRoll") };
+	constexpr int32 NumBuiltinVariables = UE_ARRAY_COUNT(BuiltinVariableNames);
+
+	const FString SourceCoefficientPrefix = TEXT("Source.");
+	const FString TargetCoefficientPrefix = TEXT("Target.");
+}
+
+/** Recursive descent parser that emits bytecode in reverse polish order while parsing */
+class FDDG_DamageFormula::FParser
+{
+public:
+	FParser(const FString& InExpression, const TArray<FName>& InVariableNames, TArray<FInstruction>& OutCode)
+		: Expression(InExpression)
+		, VariableNames(InVariableNames)
+		, Code(OutCode)
+	{
+	}
+
+	bool Parse()
+	{
+		ParseComparison();
+		SkipWhitespace();
+		if (!bError && Position < Expression.Len())
+		{
+			Fail(TEXT("unexpected character"));
+		}
+		if (!bError && MaxDepth > MaxStackDepth)
+		{
+			Fail(TEXT("formula is too deeply nested"));
+		}
+		return !bError;
+	}
+
+	FString ErrorMessage;
+
+private:
+	void ParseComparison()
+	{
+		ParseSum();
+		SkipWhitespace();
+		if (Match(TEXT('<')))
+		{
+			ParseSum();
+			Emit(EOp::Less, 1);
+		}
+		else if (Match(TEXT('>')))
+		{
+			ParseSum();
+			Emit(EOp::Greater, 1);
+		}
+	}
+
+	void ParseSum()
+	{
+		ParseProduct();
+		while (!bError)
+		{
+			SkipWhitespace();
+			if (Match(TEXT('+')))
+			{
+				ParseProduct();
+				Emit(EOp::Add, 1);
+			}
+			else if (Match(TEXT('-')))
+			{
+				ParseProduct();
+				Emit(EOp::Sub, 1);
+			}
+			else
+			{
+				break;
+			}
+		}
+	}
+
+	void ParseProduct()
+	{
+		ParseUnary();
+		while (!bError)
+		{
+			SkipWhitespace();
+			if (Match(TEXT('*')))
+			{
+				ParseUnary();
+				Emit(EOp::Mul, 1);
+			}
+			else if (Match(TEXT('/')))
+			{
+				ParseUnary();
+				Emit(EOp::Div, 1);
+			}
+			else
+			{
+				break;
+			}
+		}
+	}
+
+	void ParseUnary()
+	{
+		SkipWhitespace();
+		if (Match(TEXT('-')))
+		{
+			ParseUnary();
+			Emit(EOp::Neg, 0);
+			return;
+		}
+		ParsePrimary();
+	}
+
+	void ParsePrimary()
+	{
+		if (bError)
+		{
+			return;
+		}
+
+		SkipWhitespace();
+		if (Match(TEXT('(')))
+		{
+			ParseComparison();
+			Expect(TEXT(')'));
+			return;
+		}
+
+		const int32 Start = Position;
+		if (Position < Expression.Len() && (FChar::IsDigit(Expression[Position]) || Expression[Position] == TEXT('.')))
+		{
+			while (Position < Expression.Len() && (FChar::IsDigit(Expression[Position]) || Expression[Position] == TEXT('.')))
+			{
+				++Position;
+			}
+			FInstruction Instruction = { EOp::PushConst, 0, FCString::Atof(*Expression.Mid(Start, Position - Start)) };
+			Push(Instruction);
+			return;
+		}
+
+		while (Position < Expression.Len() && (FChar::IsAlnum(Expression[Position]) || Expression[Position] == TEXT('_') || Expression[Position] == TEXT('.')))
+		{
+			++Position;
+		}
+		if (Start == Position)
+		{
+			Fail(TEXT("expected a number, variable or function"));
+			return;
+		}
+		const FString Identifier = Expression.Mid(Start, Position - Start);
+
+		SkipWhitespace();
+		if (Match(TEXT('(')))
+		{
+			ParseFunction(Identifier);
+			return;
+		}
+
+		const int32 VariableIndex = VariableNames.IndexOfByKey(FName(*Identifier));
+		if (VariableIndex == INDEX_NONE)
+		{
+			Fail(FString::Printf(TEXT("unknown variable %s"), *Identifier));
+			return;
+		}
+		FInstruction Instruction = { EOp::PushVar, static_cast<uint16>(VariableIndex), 0.f };
+		Push(Instruction);
+	}
+
+	void ParseFunction(const FString& FunctionName)
+	{
+		int32 NumArgs = 0;
+		SkipWhitespace();
+		if (!Match(TEXT(')')))
+		{
+			do
+			{
+				ParseComparison();
+				++NumArgs;
+				SkipWhitespace();
+			} while (!bError && Match(TEXT(',')));
+			Expect(TEXT(')'));
+		}
+
+		if (bError)
+		{
+			return;
+		}
+
+		if (FunctionName == TEXT("min") && NumArgs == 2)
+		{
+			Emit(EOp::Min, 1);
+		}
+		else if (FunctionName == TEXT("max") && NumArgs == 2)
+		{
+			Emit(EOp::Max, 1);
+		}
+		else if (FunctionName == TEXT("clamp") && NumArgs == 3)
+		{
+			Emit(EOp::Clamp, 2);
+		}
+		else
+		{
+			Fail(FString::Printf(TEXT("unknown function %s with %d arguments"), *FunctionName, NumArgs));
+		}
+	}
+
+	void Push(const FInstruction& Instruction)
+	{
+		Code.Add(Instruction);
+		MaxDepth = FMath::Max(MaxDepth, ++Depth);
+	}
+
+	// emits an operator that pops NumPopped more values than it pushes
+	void Emit(EOp Op, int32 NumPopped)
+	{
+		if (!bError)
+		{
+			FInstruction Instruction = { Op, 0, 0.f };
+			Code.Add(Instruction);
+			Depth -= NumPopped;
+		}
+	}
+
+	void SkipWhitespace()
+	{
+		while (Position < Expression.Len() && FChar::IsWhitespace(Expression[Position]))
+		{
+			++Position;
+		}
+	}
+
+	bool Match(TCHAR Character)
+	{
+		if (Position < Expression.Len() && Expression[Position] == Character)
+		{
+			++Position;
+			return true;
+		}
+		return false;
+	}
+
+	void Expect(TCHAR Character)
+	{
+		SkipWhitespace();
+		if (!bError && !Match(Character))
+		{
+			Fail(FString::Printf(TEXT("expected '%c'"), Character));
+		}
+	}
+
+	void Fail(const FString& Message)
+	{
+		if (!bError)
+		{
+			bError = true;
+			ErrorMessage = FString::Printf(TEXT("%s at position %d"), *Message, Position);
+		}
+	}
+
+	const FString& Expression;
+	const TArray<FName>& VariableNames;
+	TArray<FInstruction>& Code;
+	int32 Position = 0;
+	int32 Depth = 0;
+	int32 MaxDepth = 0;
+	bool bError = false;
+};
+
+bool FDDG_DamageFormula::Compile(const FString& Expression, const UCurveTable* CoefficientsTable)
+{
+	BuildVariables(CoefficientsTable);
+
+	Code.Reset();
+	FParser Parser(Expression, VariableNames, Code);
+	if (!Parser.Parse())
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s() Could not compile damage formula \"%s\": %s. Falling back to BaseDamage."), *FString(__FUNCTION__), *Expression, *Parser.ErrorMessage);
+		CompileFallback();
+		return false;
+	}
+
+	Code.Shrink();
+	bCompiled = true;
+
+	UE_LOG(LogTemp, Log, TEXT("Damage formula compiled to %d instructions with %d coefficients"), Code.Num(), Coefficients.Num());
+	return true;
+}
+
+void FDDG_DamageFormula::CompileFallback()
+{
+	Code.Reset();
+	FInstruction Instruction = { EOp::PushVar, 0, 0.f };
+	Code.Add(Instruction);
+	bCompiled = true;
+}
+
+void FDDG_DamageFormula::BuildVariables(const UCurveTable* CoefficientsTable)
+{
+	VariableNames.Reset();
+	Coefficients.Reset();
+
+	for (const TCHAR* BuiltinName : BuiltinVariableNames)
+	{
+		VariableNames.Add(FName(BuiltinName));
+	}
+
+	if (!CoefficientsTable)
+	{
+		UE_LOG(LogTemp, Log, TEXT("%s() No damage coefficients table, only the built in variables can be used."), *FString(__FUNCTION__));
+		return;
+	}
+
+	for (const TPair<FName, FRealCurve*>& Row : CoefficientsTable->GetRowMap())
+	{
+		const FString RowString = Row.Key.ToString();
+		const bool bTargetLevel = RowString.StartsWith(TargetCoefficientPrefix);
+		if (!Row.Value || (!bTargetLevel && !RowString.StartsWith(SourceCoefficientPrefix)))
+		{
+			continue;
+		}
+
+		if (VariableNames.Num() >= MaxVariables)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("%s() Too many damage coefficients, ignoring %s"), *FString(__FUNCTION__), *RowString);
+			continue;
+		}
+
+		float MinLevel = 0.f;
+		float MaxLevel = 0.f;
+		Row.Value->GetTimeRange(MinLevel, MaxLevel);
+
+		FCoefficient& Coefficient = Coefficients.AddDefaulted_GetRef();
+		Coefficient.bTargetLevel = bTargetLevel;
+		Coefficient.ValuesByLevel.SetNum(FMath::Max(FMath::CeilToInt(MaxLevel), 0) + 1);
+		for (int32 Level = 0; Level < Coefficient.ValuesByLevel.Num(); ++Level)
+		{
+			Coefficient.ValuesByLevel[Level] = Row.Value->Eval(Level);
+		}
+
+		VariableNames.Add(Row.Key);
+	}
+}
+
+float FDDG_DamageFormula::Evaluate(const FDDG_DamageFormulaInput& Input) const
+{
+	checkSlow(bCompiled);
+
+	float Variables[MaxVariables];
+	Variables[0] = Input.BaseDamage;
+	Variables[1] = Input.SourceLevel;
+	Variables[2] = Input.TargetLevel;
+	Variables[3] = Input.TargetHealth;
+	Variables[4] = Input.TargetMaxHealth;
+	Variables[5] = Input.CritRoll;
+
+	const int32 SourceLevel = FMath::RoundToInt(Input.SourceLevel);
+	const int32 TargetLevel = FMath::RoundToInt(Input.TargetLevel);
+	for (int32 Idx = 0; Idx < Coefficients.Num(); ++Idx)
+	{
+		const FCoefficient& Coefficient = Coefficients[Idx];
+		const int32 Level = FMath::Clamp(Coefficient.bTargetLevel ? TargetLevel : SourceLevel, 0, Coefficient.ValuesByLevel.Num() - 1);
+		Variables[NumBuiltinVariables + Idx] = Coefficient.ValuesByLevel[Level];
+	}
+
+	// stack depth was validated at compile time
+	float Stack[MaxStackDepth];
+	int32 Top = -1;
+	for (const FInstruction& Instruction : Code)
+	{
+		switch (Instruction.Op)
+		{
+		case EOp::PushConst:	Stack[++Top] = Instruction.Value; break;
+		case EOp::PushVar:		Stack[++Top] = Variables[Instruction.Index]; break;
+		case EOp::Add:			--Top; Stack[Top] += Stack[Top + 1]; break;
+		case EOp::Sub:			--Top; Stack[Top] -= Stack[Top + 1]; break;
+		case EOp::Mul:			--Top; Stack[Top] *= Stack[Top + 1]; break;
+		case EOp::Div:			--Top; Stack[Top] = (Stack[Top + 1] != 0.f) ? Stack[Top] / Stack[Top + 1] : 0.f; break;
+		case EOp::Neg:			Stack[Top] = -Stack[Top]; break;
+		case EOp::Less:			--Top; Stack[Top] = (Stack[Top] < Stack[Top + 1]) ? 1.f : 0.f; break;
+		case EOp::Greater:		--Top; Stack[Top] = (Stack[Top] > Stack[Top + 1]) ? 1.f : 0.f; break;
+		case EOp::Min:			--Top; Stack[Top] = FMath::Min(Stack[Top], Stack[Top + 1]); break;
+		case EOp::Max:			--Top; Stack[Top] = FMath::Max(Stack[Top], Stack[Top + 1]); break;
+		case EOp::Clamp:		Top -= 2; Stack[Top] = FMath::Clamp(Stack[Top], Stack[Top + 1], Stack[Top + 2]); break;
+		}
+	}
+
+	return (Top == 0) ? Stack[0] : 0.f;
+}
+
+void FDDG_DamageFormula::EvaluateBatch(TArrayView<const FDDG_DamageFormulaInput> Inputs, TArrayView<float> OutDamage, int32 ItemsPerTask) const
+{
+	check(Inputs.Num() == OutDamage.Num());
+
+	const int32 NumItems = Inputs.Num();
+	const int32 ChunkSize = FMath::Max(ItemsPerTask, 1);
+	const int32 NumChunks = FMath::DivideAndRoundUp(NumItems, ChunkSize);
+
+	ParallelFor(NumChunks, [this, &Inputs, &OutDamage, NumItems, ChunkSize](int32 ChunkIndex)
+	{
+		const int32 Start = ChunkIndex * ChunkSize;
+		const int32 End = FMath::Min(Start + ChunkSize, NumItems);
+		for (int32 Idx = Start; Idx < End; ++Idx)
+		{
+			OutDamage[Idx] = Evaluate(Inputs[Idx]);
+		}
+	});
+}
@@ -0,0 +1,338 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "System/DDG_CombatJournal.h"
+#include "Containers/Queue.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/FileManager.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/Event.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+#include "UObject/Object.h"
+#include "UObject/UObjectArray.h"
+#include <atomic>
+
+static TAutoConsoleVariable<int32> CVarJournalEnabled(
+	TEXT("DDG.Journal.Enabled"),
+	1,
+	TEXT("Records combat events to the binary combat journal."));
+
+static TAutoConsoleVariable<int32> CVarJournalFlushInterval(
+	TEXT("DDG.Journal.FlushInterval"),
+	250,
+	TEXT("Milliseconds between combat journal flushes to disk."));
+
+namespace
+{
+	/** Single producer (the owning thread) single consumer (the writer thread) ring of records */
+	struct FJournalThreadBuffer
+	{
+		static constexpr uint32 Capacity = 4096;
+		static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+		FDDG_CombatJournalRecord Records[Capacity];
+
+		// producer and consumer indices padded apart so they do not false share
+		std::atomic<uint32> Head{ 0 };
+		std::atomic<uint32> Dropped{ 0 };
+		uint8 Padding[PLATFORM_CACHE_LINE_SIZE];
+		std::atomic<uint32> Tail{ 0 };
+
+		uint16 ThreadIndex = 0;
+
+		// names of objects first seen on this thread, enqueued before the record using them is published
+		TQueue<TPair<uint32, FString>, EQueueMode::Spsc> PendingNames;
+
+		// only touched by the owning thread. Objects recorded from several threads are named once per thread
+		TSet<uint32> NamedIds;
+		uint32 NamedGeneration = 0;
+	};
+
+	std::atomic<bool> bJournalEnabled{ false };
+	thread_local FJournalThreadBuffer* ThreadBuffer = nullptr;
+
+	// buffers live until process exit so thread_local pointers stay valid across Shutdown / Startup
+	FCriticalSection BuffersLock;
+	TArray<FJournalThreadBuffer*> Buffers;
+
+	// bumped by every Startup so each thread names its objects again in the new journal file
+	std::atomic<uint32> JournalGeneration{ 0 };
+
+	const TCHAR* const EventNames[] = { TEXT("Damage"), TEXT("DamageIgnoredDead"), TEXT("Death"), TEXT("LevelUp"), TEXT("AttributeChange"), TEXT("Dropped") };
+	static_assert(UE_ARRAY_COUNT(EventNames) == static_cast<int32>(EDDG_JournalEvent::Count), "Missing journal event name");
+
+	const TCHAR* const AttributeNames[] = { TEXT("None"), TEXT("Damage"), TEXT("CharacterLevel"), TEXT("Health"), TEXT("MaxHealth"), TEXT("HealthRegenRate"), TEXT("Mana"), TEXT("MaxMana"), TEXT("ManaRegenRate") };
+	static_assert(UE_ARRAY_COUNT(AttributeNames) == static_cast<int32>(EDDG_JournalAttribute::Count), "Missing journal attribute name");
+
+	FJournalThreadBuffer* RegisterThreadBuffer()
+	{
+		FJournalThreadBuffer* NewBuffer = new FJournalThreadBuffer();
+
+		FScopeLock Lock(&BuffersLock);
+		NewBuffer->ThreadIndex = static_cast<uint16>(Buffers.Num());
+		Buffers.Add(NewBuffer);
+		return NewBuffer;
+	}
+
+	// the object serial number (the one FObjectKey uses) is never reused, unlike the object index after GC
+	uint32 GetJournalId(FJournalThreadBuffer& Buffer, const UObject* Object)
+	{
+		if (!Object)
+		{
+			return 0;
+		}
+
+		const uint32 ObjectId = static_cast<uint32>(GUObjectArray.AllocateSerialNumber(GUObjectArray.ObjectToIndex(Object)));
+		if (!Buffer.NamedIds.Contains(ObjectId))
+		{
+			// first time this thread sees the object, its name is written once instead of in every record
+			Buffer.NamedIds.Add(ObjectId);
+			Buffer.PendingNames.Enqueue(TPair<uint32, FString>(ObjectId, Object->GetFullName()));
+		}
+		return ObjectId;
+	}
+
+	/** Background thread draining every ring buffer to the journal file */
+	class FJournalWriter : public FRunnable
+	{
+	public:
+		FJournalWriter()
+		{
+			WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+			Thread = FRunnableThread::Create(this, TEXT("DDG_CombatJournalWriter"), 0, TPri_BelowNormal);
+		}
+
+		virtual ~FJournalWriter()
+		{
+			bStopRequested = true;
+			WakeEvent->Trigger();
+			if (Thread)
+			{
+				Thread->WaitForCompletion();
+				delete Thread;
+			}
+			FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+
+			// records written after the thread stopped
+			Drain();
+			delete FileWriter;
+		}
+
+		virtual uint32 Run() override
+		{
+			while (!bStopRequested)
+			{
+				WakeEvent->Wait(FMath::Max(CVarJournalFlushInterval.GetValueOnAnyThread(), 1));
+				Drain();
+			}
+			return 0;
+		}
+
+	private:
+		void Drain()
+		{
+			{
+				FScopeLock Lock(&BuffersLock);
+				for (FJournalThreadBuffer* Buffer : Buffers)
+				{
+					const uint32 Tail = Buffer->Tail.load(std::memory_order_relaxed);
+					const uint32 Head = Buffer->Head.load(std::memory_order_acquire);
+
+					// names are dequeued after reading the head, so every record up to it has its name in this flush
+					TPair<uint32, FString> Name;
+					while (Buffer->PendingNames.Dequeue(Name))
+					{
+						WriterNames.Add(MoveTemp(Name));
+					}
+
+					for (uint32 Idx = Tail; Idx != Head; ++Idx)
+					{
+						PendingRecords.Add(Buffer->Records[Idx & (FJournalThreadBuffer::Capacity - 1)]);
+					}
+					Buffer->Tail.store(Head, std::memory_order_release);
+
+					const uint32 NumDropped = Buffer->Dropped.exchange(0, std::memory_order_relaxed);
+					if (NumDropped > 0)
+					{
+						FDDG_CombatJournalRecord& DroppedRecord = PendingRecords.AddZeroed_GetRef();
+						DroppedRecord.Cycles = FPlatformTime::Cycles64();
+						DroppedRecord.ThreadIndex = Buffer->ThreadIndex;
+						DroppedRecord.EventType = EDDG_JournalEvent::Dropped;
+						DroppedRecord.NewValue = static_cast<float>(NumDropped);
+					}
+				}
+			}
+
+			if ((PendingRecords.Num() > 0 || WriterNames.Num() > 0) && OpenFile())
+			{
+				// names first so a reader stopping at a cut off block still has the names of the records before it
+				if (WriterNames.Num() > 0)
+				{
+					WriteBlockHeader(EDDG_JournalBlock::Names, WriterNames.Num());
+					for (const TPair<uint32, FString>& Name : WriterNames)
+					{
+						FTCHARToUTF8 Utf8Name(*Name.Value);
+						uint32 ObjectId = Name.Key;
+						uint32 NameLength = Utf8Name.Length();
+						FileWriter->Serialize(&ObjectId, sizeof(ObjectId));
+						FileWriter->Serialize(&NameLength, sizeof(NameLength));
+						FileWriter->Serialize(const_cast<ANSICHAR*>(Utf8Name.Get()), NameLength);
+					}
+				}
+
+				if (PendingRecords.Num() > 0)
+				{
+					WriteBlockHeader(EDDG_JournalBlock::Records, PendingRecords.Num());
+					FileWriter->Serialize(PendingRecords.GetData(), PendingRecords.Num() * sizeof(FDDG_CombatJournalRecord));
+				}
+				FileWriter->Flush();
+			}
+
+			PendingRecords.Reset();
+			WriterNames.Reset();
+		}
+
+		void WriteBlockHeader(EDDG_JournalBlock BlockType, int32 Count)
+		{
+			FDDG_CombatJournalBlockHeader BlockHeader;
+			BlockHeader.BlockType = BlockType;
+			BlockHeader.Count = static_cast<uint32>(Count);
+			FileWriter->Serialize(&BlockHeader, sizeof(BlockHeader));
+		}
+
+		// the file is only created once there is something to write
+		bool OpenFile()
+		{
+			if (FileWriter)
+			{
+				return true;
+			}
+			if (bOpenFailed)
+			{
+				return false;
+			}
+
+			const FString FilePath = FPaths::ProjectLogDir() / FString::Printf(TEXT("CombatJournal-%s%s"), *FDateTime::Now().ToString(), FDDG_CombatJournal::GetFileExtension());
+			FileWriter = IFileManager::Get().CreateFileWriter(*FilePath, FILEWRITE_AllowRead);
+			if (!FileWriter)
+			{
+				UE_LOG(LogTemp, Error, TEXT("%s() Could not create combat journal %s"), *FString(__FUNCTION__), *FilePath);
+				bOpenFailed = true;
+				return false;
+			}
+
+			FDDG_CombatJournalHeader Header;
+			Header.Magic = FDDG_CombatJournalHeader::ExpectedMagic;
+			Header.Version = FDDG_CombatJournalHeader::ExpectedVersion;
+			Header.RecordSize = sizeof(FDDG_CombatJournalRecord);
+			Header.SecondsPerCycle = FPlatformTime::GetSecondsPerCycle64();
+			Header.StartCycles = StartCycles;
+			FileWriter->Serialize(&Header, sizeof(Header));
+
+			UE_LOG(LogTemp, Log, TEXT("Combat journal recording to : %s"), *FilePath);
+			return true;
+		}
+
+		FRunnableThread* Thread = nullptr;
+		FEvent* WakeEvent = nullptr;
+		std::atomic<bool> bStopRequested{ false };
+
+		FArchive* FileWriter = nullptr;
+		bool bOpenFailed = false;
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+
+		// only used by the writer, kept around so steady state flushing does not allocate
+		TArray<FDDG_CombatJournalRecord> PendingRecords;
+		TArray<TPair<uint32, FString>> WriterNames;
+	};
+
+	FJournalWriter* Writer = nullptr;
+
+	void OnJournalEnabledChanged(IConsoleVariable* Variable)
+	{
+		bJournalEnabled.store(Writer && Variable->GetInt() != 0, std::memory_order_relaxed);
+	}
+}
+
+void FDDG_CombatJournal::Startup()
+{
+	if (Writer)
+	{
+		return;
+	}
+
+	JournalGeneration.fetch_add(1, std::memory_order_relaxed);
+	Writer = new FJournalWriter();
+	CVarJournalEnabled->SetOnChangedCallback(FConsoleVariableDelegate::CreateStatic(&OnJournalEnabledChanged));
+	OnJournalEnabledChanged(CVarJournalEnabled.AsVariable());
+}
+
+void FDDG_CombatJournal::Shutdown()
+{
+	if (!Writer)
+	{
+		return;
+	}
+
+	bJournalEnabled.store(false, std::memory_order_relaxed);
+	CVarJournalEnabled->SetOnChangedCallback(FConsoleVariableDelegate());
+
+	delete Writer;
+	Writer = nullptr;
+
+	// the thread buffers are kept, a producer that passed the enabled check may still be writing to one
+}
+
+void FDDG_CombatJournal::Record(EDDG_JournalEvent EventType, EDDG_JournalAttribute Attribute, const UObject* Object, const UObject* Instigator, float OldValue, float NewValue)
+{
+	if (!bJournalEnabled.load(std::memory_order_relaxed))
+	{
+		return;
+	}
+
+	FJournalThreadBuffer* Buffer = ThreadBuffer;
+	if (!Buffer)
+	{
+		Buffer = ThreadBuffer = RegisterThreadBuffer();
+	}
+
+	const uint32 Head = Buffer->Head.load(std::memory_order_relaxed);
+	if (Head - Buffer->Tail.load(std::memory_order_acquire) >= FJournalThreadBuffer::Capacity)
+	{
+		// never block the game on the journal
+		Buffer->Dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	const uint32 Generation = JournalGeneration.load(std::memory_order_relaxed);
+	if (Buffer->NamedGeneration != Generation)
+	{
+		Buffer->NamedIds.Reset();
+		Buffer->NamedGeneration = Generation;
+	}
+
+	FDDG_CombatJournalRecord& NewRecord = Buffer->Records[Head & (FJournalThreadBuffer::Capacity - 1)];
+	NewRecord.Cycles = FPlatformTime::Cycles64();
+	NewRecord.ObjectId = GetJournalId(*Buffer, Object);
+	NewRecord.InstigatorId = GetJournalId(*Buffer, Instigator);
+	NewRecord.OldValue = OldValue;
+	NewRecord.NewValue = NewValue;
+	NewRecord.ThreadIndex = Buffer->ThreadIndex;
+	NewRecord.EventType = EventType;
+	NewRecord.Attribute = Attribute;
+	NewRecord.Sequence = Head;
+
+	Buffer->Head.store(Head + 1, std::memory_order_release);
+}
+
+const TCHAR* FDDG_CombatJournal::GetEventName(EDDG_JournalEvent EventType)
+{
+	return (EventType < EDDG_JournalEvent::Count) ? EventNames[static_cast<int32>(EventType)] : TEXT("Unknown");
+}
+
+const TCHAR* FDDG_CombatJournal::GetAttributeName(EDDG_JournalAttribute Attribute)
+{
+	return (Attribute < EDDG_JournalAttribute::Count) ? AttributeNames[static_cast<int32>(Attribute)] : TEXT("Unknown");
+}
@@ -0,0 +1,263 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "System/DDG_CombatJournalCommandlet.h"
+#include "System/DDG_CombatJournal.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	// attribute values rebuilt for one object while replaying
+	struct FJournalReplayState
+	{
+		float Attributes[static_cast<int32>(EDDG_JournalAttribute::Count)] = {};
+		bool bDead = false;
+		int32 NumHits = 0;
+		float DamageTaken = 0.f;
+		int32 NumDamageIgnoredDead = 0;
+		uint32 LastInstigatorId = 0;
+	};
+
+	FString FindNewestJournal()
+	{
+		TArray<FString> JournalFiles;
+		IFileManager::Get().FindFiles(JournalFiles, *(FPaths::ProjectLogDir() / (FString(TEXT("*")) + FDDG_CombatJournal::GetFileExtension())), true, false);
+
+		FString NewestFile;
+		FDateTime NewestTime = FDateTime::MinValue();
+		for (const FString& JournalFile : JournalFiles)
+		{
+			const FString FullPath = FPaths::ProjectLogDir() / JournalFile;
+			const FDateTime FileTime = IFileManager::Get().GetTimeStamp(*FullPath);
+			if (FileTime > NewestTime)
+			{
+				NewestTime = FileTime;
+				NewestFile = FullPath;
+			}
+		}
+		return NewestFile;
+	}
+
+	// reads every block after the header, false if the file ends in the middle of one
+	bool ReadBlocks(const TArray<uint8>& FileBytes, TArray<FDDG_CombatJournalRecord>& OutRecords, TMap<uint32, FString>& OutObjectNames)
+	{
+		const uint8* const End = FileBytes.GetData() + FileBytes.Num();
+		const uint8* Cursor = FileBytes.GetData() + sizeof(FDDG_CombatJournalHeader);
+		auto CanRead = [&Cursor, End](SIZE_T NumBytes) { return static_cast<SIZE_T>(End - Cursor) >= NumBytes; };
+
+		while (Cursor != End)
+		{
+			FDDG_CombatJournalBlockHeader BlockHeader;
+			if (!CanRead(sizeof(BlockHeader)))
+			{
+				return false;
+			}
+			FMemory::Memcpy(&BlockHeader, Cursor, sizeof(BlockHeader));
+			Cursor += sizeof(BlockHeader);
+
+			if (BlockHeader.BlockType == EDDG_JournalBlock::Records)
+			{
+				const SIZE_T BlockBytes = static_cast<SIZE_T>(BlockHeader.Count) * sizeof(FDDG_CombatJournalRecord);
+				if (!CanRead(BlockBytes))
+				{
+					return false;
+				}
+				const int32 FirstRecord = OutRecords.AddUninitialized(BlockHeader.Count);
+				FMemory::Memcpy(OutRecords.GetData() + FirstRecord, Cursor, BlockBytes);
+				Cursor += BlockBytes;
+			}
+			else if (BlockHeader.BlockType == EDDG_JournalBlock::Names)
+			{
+				for (uint32 NameIdx = 0; NameIdx < BlockHeader.Count; ++NameIdx)
+				{
+					uint32 ObjectId = 0;
+					uint32 NameLength = 0;
+					if (!CanRead(sizeof(ObjectId) + sizeof(NameLength)))
+					{
+						return false;
+					}
+					FMemory::Memcpy(&ObjectId, Cursor, sizeof(ObjectId));
+					FMemory::Memcpy(&NameLength, Cursor + sizeof(ObjectId), sizeof(NameLength));
+					Cursor += sizeof(ObjectId) + sizeof(NameLength);
+
+					if (!CanRead(NameLength))
+					{
+						return false;
+					}
+					FUTF8ToTCHAR Name(reinterpret_cast<const ANSICHAR*>(Cursor), NameLength);
+					OutObjectNames.Add(ObjectId, FString(Name.Length(), Name.Get()));
+					Cursor += NameLength;
+				}
+			}
+			else
+			{
+				// block sizes are unknown for other types, nothing after it can be trusted
+				UE_LOG(LogTemp, Error, TEXT("%s() Unknown combat journal block type %u"), *FString(__FUNCTION__), static_cast<uint32>(BlockHeader.BlockType));
+				return false;
+			}
+		}
+		return true;
+	}
+
+	FString GetObjectLabel(const TMap<uint32, FString>& ObjectNames, uint32 ObjectId)
+	{
+		if (ObjectId == 0)
+		{
+			return TEXT("None");
+		}
+		const FString* Name = ObjectNames.Find(ObjectId);
+		return Name ? *Name : FString::Printf(TEXT("Object %u"), ObjectId);
+	}
+}
+
+UDDG_CombatJournalCommandlet::UDDG_CombatJournalCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UDDG_CombatJournalCommandlet::Main(const FString& Params)
+{
+	FString FilePath;
+	if (!FParse::Value(*Params, TEXT("File="), FilePath))
+	{
+		FilePath = FindNewestJournal();
+	}
+
+	TArray<uint8> FileBytes;
+	if (FilePath.IsEmpty() || !FFileHelper::LoadFileToArray(FileBytes, *FilePath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s() Could not read combat journal '%s'"), *FString(__FUNCTION__), *FilePath);
+		return 1;
+	}
+
+	FDDG_CombatJournalHeader Header;
+	if (FileBytes.Num() < static_cast<int32>(sizeof(Header)))
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s() %s is too small to be a combat journal"), *FString(__FUNCTION__), *FilePath);
+		return 1;
+	}
+	FMemory::Memcpy(&Header, FileBytes.GetData(), sizeof(Header));
+
+	if (Header.Magic != FDDG_CombatJournalHeader::ExpectedMagic || Header.Version != FDDG_CombatJournalHeader::ExpectedVersion || Header.RecordSize != sizeof(FDDG_CombatJournalRecord))
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s() %s is not a version %d combat journal"), *FString(__FUNCTION__), *FilePath, FDDG_CombatJournalHeader::ExpectedVersion);
+		return 1;
+	}
+
+	TArray<FDDG_CombatJournalRecord> Records;
+	TMap<uint32, FString> ObjectNames;
+	if (!ReadBlocks(FileBytes, Records, ObjectNames))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s() %s ends with a partial block, it was probably cut off by a crash"), *FString(__FUNCTION__), *FilePath);
+	}
+
+	// each thread's records are flushed in order, so a sequence gap means records are missing from the file (full buffers are reported as Dropped instead)
+	TMap<uint16, uint32> NextSequenceByThread;
+	int32 NumDropped = 0;
+	for (const FDDG_CombatJournalRecord& Record : Records)
+	{
+		if (Record.EventType == EDDG_JournalEvent::Dropped)
+		{
+			NumDropped += static_cast<int32>(Record.NewValue);
+			continue;
+		}
+
+		if (const uint32* NextSequence = NextSequenceByThread.Find(Record.ThreadIndex))
+		{
+			if (Record.Sequence != *NextSequence)
+			{
+				UE_LOG(LogTemp, Warning, TEXT("Thread %d is missing %u records before sequence %u"), Record.ThreadIndex, Record.Sequence - *NextSequence, Record.Sequence);
+			}
+		}
+		NextSequenceByThread.Add(Record.ThreadIndex, Record.Sequence + 1);
+	}
+
+	// merge the per thread streams back into one timeline
+	Records.StableSort([](const FDDG_CombatJournalRecord& A, const FDDG_CombatJournalRecord& B)
+	{
+		return A.Cycles < B.Cycles;
+	});
+
+	FString CsvPath;
+	const bool bWriteCsv = FParse::Value(*Params, TEXT("Csv="), CsvPath);
+	FString CsvText;
+	if (bWriteCsv)
+	{
+		CsvText.Reserve((Records.Num() + 1) * 64);
+		CsvText += TEXT("Seconds,Thread,Event,Object,Instigator,Attribute,OldValue,NewValue\n");
+	}
+
+	TMap<uint32, FJournalReplayState> ReplayStates;
+	for (const FDDG_CombatJournalRecord& Record : Records)
+	{
+		if (bWriteCsv)
+		{
+			const double Seconds = (static_cast<int64>(Record.Cycles) - static_cast<int64>(Header.StartCycles)) * Header.SecondsPerCycle;
+			CsvText += FString::Printf(TEXT("%.6f,%d,%s,%s,%s,%s,%f,%f\n"), Seconds, Record.ThreadIndex, FDDG_CombatJournal::GetEventName(Record.EventType),
+				*GetObjectLabel(ObjectNames, Record.ObjectId), *GetObjectLabel(ObjectNames, Record.InstigatorId),
+				FDDG_CombatJournal::GetAttributeName(Record.Attribute), Record.OldValue, Record.NewValue);
+		}
+
+		if (Record.EventType == EDDG_JournalEvent::Dropped)
+		{
+			continue;
+		}
+
+		FJournalReplayState& State = ReplayStates.FindOrAdd(Record.ObjectId);
+		switch (Record.EventType)
+		{
+		case EDDG_JournalEvent::AttributeChange:
+		case EDDG_JournalEvent::LevelUp:
+			if (Record.Attribute < EDDG_JournalAttribute::Count)
+			{
+				State.Attributes[static_cast<int32>(Record.Attribute)] = Record.NewValue;
+			}
+			break;
+		case EDDG_JournalEvent::Damage:
+			++State.NumHits;
+			State.DamageTaken += Record.OldValue;
+			State.LastInstigatorId = Record.InstigatorId;
+			State.Attributes[static_cast<int32>(EDDG_JournalAttribute::Health)] = Record.NewValue;
+			break;
+		case EDDG_JournalEvent::DamageIgnoredDead:
+			++State.NumDamageIgnoredDead;
+			break;
+		case EDDG_JournalEvent::Death:
+			State.bDead = true;
+			State.LastInstigatorId = Record.InstigatorId;
+			break;
+		default:
+			break;
+		}
+	}
+
+	const double DurationSeconds = Records.Num() > 0 ? (Records.Last().Cycles - Records[0].Cycles) * Header.SecondsPerCycle : 0.0;
+	UE_LOG(LogTemp, Display, TEXT("Combat journal %s : %d records over %.2f seconds, %d objects, %d records dropped"), *FilePath, Records.Num(), DurationSeconds, ReplayStates.Num(), NumDropped);
+
+	auto GetAttribute = [](const FJournalReplayState& State, EDDG_JournalAttribute Attribute) { return State.Attributes[static_cast<int32>(Attribute)]; };
+	for (const TPair<uint32, FJournalReplayState>& Pair : ReplayStates)
+	{
+		const FJournalReplayState& State = Pair.Value;
+		UE_LOG(LogTemp, Display, TEXT("%s : level %.0f, health %.1f/%.1f, mana %.1f/%.1f, %d hits for %.1f damage, %s (last instigator %s), %d hits ignored while dead"),
+			*GetObjectLabel(ObjectNames, Pair.Key), GetAttribute(State, EDDG_JournalAttribute::CharacterLevel),
+			GetAttribute(State, EDDG_JournalAttribute::Health), GetAttribute(State, EDDG_JournalAttribute::MaxHealth),
+			GetAttribute(State, EDDG_JournalAttribute::Mana), GetAttribute(State, EDDG_JournalAttribute::MaxMana),
+			State.NumHits, State.DamageTaken, State.bDead ? TEXT("dead") : TEXT("alive"), *GetObjectLabel(ObjectNames, State.LastInstigatorId), State.NumDamageIgnoredDead);
+	}
+
+	if (bWriteCsv)
+	{
+		if (!FFileHelper::SaveStringToFile(CsvText, *CsvPath))
+		{
+			UE_LOG(LogTemp, Error, TEXT("%s() Could not write %s"), *FString(__FUNCTION__), *CsvPath);
+			return 1;
+		}
+		UE_LOG(LogTemp, Display, TEXT("Decoded journal written to : %s"), *CsvPath);
+	}
+
+	return 0;
+}
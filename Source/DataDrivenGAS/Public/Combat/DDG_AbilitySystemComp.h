@@ -6,6 +6,19 @@
 #include "AbilitySystemComponent.h"
 #include "DDG_AbilitySystemComp.generated.h"
 
+/** Estimated memory held by the gameplay effects of one ability system component */
+struct FDDG_EffectMemoryStats
+{
+	int32 NumActiveEffects = 0;
+	int32 NumRuntimeEffects = 0;
+	// allocation of the active effect container, slack included
+	SIZE_T ActiveEffectBytes = 0;
+	SIZE_T SpecBytes = 0;
+	SIZE_T RuntimeEffectBytes = 0;
+
+	SIZE_T GetTotalBytes() const { return ActiveEffectBytes + SpecBytes + RuntimeEffectBytes; }
+};
+
 /**
  * 
  */
@@ -13,5 +26,30 @@ UCLASS()
 class DATADRIVENGAS_API UDDG_AbilitySystemComp : public UAbilitySystemComponent
 {
 	GENERATED_BODY()
-	
+
+public:
+	// Creates a runtime gameplay effect (e.g. level up stats) that is tracked for memory accounting
+	UGameplayEffect* CreateRuntimeGameplayEffect(FName BaseName);
+
+	// Walks active effects, specs and runtime effects to estimate their memory
+	FDDG_EffectMemoryStats GetEffectMemoryStats() const;
+
+	// Prunes runtime effects already reclaimed by GC from the tracking list and checks the per component memory budget.
+	// Active effects themselves are owned and removed by GAS
+	void CheckEffectMemory();
+
+	// Sums the current memory of every ability system component that began play
+	static SIZE_T GetGlobalEffectMemoryBytes();
+
+	// Checks the global memory budget, runs at most once per check interval when called from the periodic pass
+	static void CheckGlobalEffectMemory();
+
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	// weak so tracking never keeps an effect alive, GC reclaims them once no spec references them
+	TArray<TWeakObjectPtr<UGameplayEffect>> RuntimeEffects;
+
+	FTimerHandle MemoryCheckTimerHandle;
 };
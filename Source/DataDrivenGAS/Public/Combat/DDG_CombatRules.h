@@ -0,0 +1,28 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Damage rule shared by UDDG_AttributeSet and the crowd combat fragments,
+ * so a crowd entity and a full GAS character die to the same hits.
+ */
+namespace DDGCombatRules
+{
+	// Applies damage to health/mana. Returns true if the damage killed the target
+	FORCEINLINE bool ApplyDamage(float DamageDone, float& Health, float& Mana, float MaxHealth)
+	{
+		//check if damage would kill if it's greater than current health
+		if (DamageDone >= Health)
+		{
+			Health = 0.f;
+			Mana = 0.f;
+			return true;
+		}
+
+		// Apply the health change and then clamp it
+		Health = FMath::Clamp(Health - DamageDone, 0.f, MaxHealth);
+		return false;
+	}
+}
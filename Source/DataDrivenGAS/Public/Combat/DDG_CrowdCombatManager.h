@@ -0,0 +1,159 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "DDG_CrowdCombatManager.generated.h"
+
+/** Handle to a crowd combatant. Serial changes whenever the slot is reused, so stale handles are rejected */
+USTRUCT(BlueprintType)
+struct DATADRIVENGAS_API FDDG_CrowdEntityHandle
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+		int32 Index = INDEX_NONE;
+
+	UPROPERTY()
+		int32 Serial = 0;
+
+	bool IsSet() const { return Index != INDEX_NONE; }
+};
+
+/**
+ * Packed combat attributes of one crowd entity. Mirrors the attributes of UDDG_AttributeSet
+ * without the UObject, replication and aggregator overhead
+ */
+struct FDDG_CrowdAttributeFragment
+{
+	float CharacterLevel = 1.f;
+	float Health = 0.f;
+	float MaxHealth = 0.f;
+	float HealthRegenRate = 0.f;
+	float Mana = 0.f;
+	float MaxMana = 0.f;
+	float ManaRegenRate = 0.f;
+	// damage queued this frame, resolved by the damage system like the Damage meta attribute
+	float PendingDamage = 0.f;
+};
+
+/** Level stats read once from the stats table and shared by every entity of the same character/level */
+struct FDDG_CrowdStatBlock
+{
+	FString CharacterName;
+	int32 Level = 1;
+	float MaxHealth = 0.f;
+	float HealthRegenRate = 0.f;
+	float MaxMana = 0.f;
+	float ManaRegenRate = 0.f;
+};
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FDDG_OnCrowdEntityDied, FDDG_CrowdEntityHandle);
+DECLARE_MULTICAST_DELEGATE_TwoParams(FDDG_OnCrowdEntityPromoted, FDDG_CrowdEntityHandle, class ADataDrivenGASCharacter*);
+
+/**
+ * Crowd combat mode for large battles. Combatants are stored as packed fragments in contiguous arrays
+ * and updated by parallel systems; they only become full GAS characters when a player gets close
+ */
+UCLASS()
+class DATADRIVENGAS_API ADDG_CrowdCombatManager : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ADDG_CrowdCombatManager();
+
+	//same level up stats table used by ADataDrivenGASCharacter
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = LevelUpStats)
+		class UCurveTable* StatsTable;
+
+	//character spawned when a crowd entity is promoted to a full GAS character
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Crowd")
+		TSubclassOf<class ADataDrivenGASCharacter> PromotedCharacterClass;
+
+	//players closer than this promote crowd entities to full characters
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Crowd")
+		float PromotionRadius = 1500.f;
+
+	//spawning characters is expensive so only this many are promoted per tick, the rest wait for the next one
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Crowd")
+		int32 MaxPromotionsPerTick = 8;
+
+	//number of entities processed by one parallel task
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Crowd")
+		int32 EntitiesPerTask = 1024;
+
+	UFUNCTION(BlueprintCallable, Category = "Crowd")
+		FDDG_CrowdEntityHandle SpawnCrowdEntity(const FString& CharacterName, int32 Level, const FVector& Location);
+
+	UFUNCTION(BlueprintCallable, Category = "Crowd")
+		void DestroyCrowdEntity(FDDG_CrowdEntityHandle Entity);
+
+	// Queues damage on the entity, resolved on the next tick by the damage system
+	UFUNCTION(BlueprintCallable, Category = "Crowd")
+		void ApplyDamageToCrowdEntity(FDDG_CrowdEntityHandle Entity, float Damage);
+
+	// Sets the entity level and reapplies the level stats, same as ApplyLevelAttributes on a character
+	UFUNCTION(BlueprintCallable, Category = "Crowd")
+		void SetCrowdEntityLevel(FDDG_CrowdEntityHandle Entity, int32 NewLevel);
+
+	UFUNCTION(BlueprintCallable, Category = "Crowd")
+		void SetCrowdEntityLocation(FDDG_CrowdEntityHandle Entity, const FVector& NewLocation);
+
+	UFUNCTION(BlueprintCallable, Category = "Crowd")
+		bool IsCrowdEntityAlive(FDDG_CrowdEntityHandle Entity) const;
+
+	UFUNCTION(BlueprintCallable, Category = "Crowd")
+		int32 GetNumCrowdEntities() const { return NumActiveEntities; }
+
+	// Spawns the full GAS character for this entity and removes it from the crowd
+	UFUNCTION(BlueprintCallable, Category = "Crowd")
+		class ADataDrivenGASCharacter* PromoteCrowdEntity(FDDG_CrowdEntityHandle Entity);
+
+	const FDDG_CrowdAttributeFragment* GetAttributes(FDDG_CrowdEntityHandle Entity) const;
+
+	FDDG_OnCrowdEntityDied OnCrowdEntityDied;
+	FDDG_OnCrowdEntityPromoted OnCrowdEntityPromoted;
+
+	virtual void Tick(float DeltaSeconds) override;
+
+private:
+	enum EEntityFlags : uint8
+	{
+		Flag_Active = 1 << 0,
+		Flag_Dead = 1 << 1,
+		Flag_JustDied = 1 << 2,
+		Flag_WantsPromotion = 1 << 3,
+		Flag_PromotionFailed = 1 << 4,
+	};
+
+	bool IsValidHandle(FDDG_CrowdEntityHandle Entity) const;
+
+	// finds or builds the cached stats for a character/level pair
+	int32 FindOrAddStatBlock(const FString& CharacterName, int32 Level);
+	float ReadLevelStat(const FString& CharacterName, int32 Level, const struct FGameplayAttribute& Attribute) const;
+	void ApplyStatBlock(int32 EntityIndex, int32 StatBlockIndex);
+
+	// parallel systems
+	void RunDamageSystem();
+	void RunPromotionSystem();
+
+	void ReleaseEntity(int32 EntityIndex);
+
+	// Structure of arrays, one element per entity slot
+	TArray<FDDG_CrowdAttributeFragment> Attributes;
+	TArray<FVector> Locations;
+	TArray<int32> StatBlockIndices;
+	TArray<int32> Serials;
+	TArray<uint8> Flags;
+
+	TArray<int32> FreeIndices;
+	int32 NumActiveEntities = 0;
+
+	TArray<FDDG_CrowdStatBlock> StatBlocks;
+	TMap<FName, int32> StatBlockLookup;
+
+	// gathered every tick from the player pawns, read by the promotion system
+	TArray<FVector> PlayerLocations;
+};
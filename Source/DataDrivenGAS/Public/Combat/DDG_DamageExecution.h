@@ -0,0 +1,51 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameplayEffectExecutionCalculation.h"
+#include "Combat/DDG_DamageFormula.h"
+#include "DDG_DamageExecution.generated.h"
+
+/**
+ * Data driven damage execution. The formula comes from config and its coefficients from the damage coefficients csv,
+ * the result is written to the Damage meta attribute which UDDG_AttributeSet turns into -Health.
+ * Base damage is passed as the Data.Damage set by caller magnitude.
+ */
+UCLASS(config=Game)
+class DATADRIVENGAS_API UDDG_DamageExecution : public UGameplayEffectExecutionCalculation
+{
+	GENERATED_BODY()
+
+public:
+	UDDG_DamageExecution();
+
+	//damage formula, see FDDG_DamageFormula for the syntax and available variables
+	UPROPERTY(config, EditDefaultsOnly, Category = "Damage")
+		FString DamageFormula;
+
+	//level curves of the formula coefficients as csv, relative to the project directory. Each "Source.X" / "Target.X" row becomes a formula variable
+	UPROPERTY(config, EditDefaultsOnly, Category = "Damage")
+		FString CoefficientsCsvPath;
+
+	//optional imported curve table, used instead of CoefficientsCsvPath when set
+	UPROPERTY(config, EditDefaultsOnly, Category = "Damage")
+		TSoftObjectPtr<class UCurveTable> CoefficientsTable;
+
+	virtual void PostInitProperties() override;
+
+	virtual void Execute_Implementation(const FGameplayEffectCustomExecutionParameters& ExecutionParams, FGameplayEffectCustomExecutionOutput& OutExecutionOutput) const override;
+
+	// Compiled formula of the class default object, shared with batch evaluation (e.g. crowd combat).
+	// Compiled when the class default object is created, so it can be read from any thread
+	static const FDDG_DamageFormula& GetCompiledFormula();
+
+	// Reloads the formula and coefficients table from config and recompiles them
+	static void RecompileFormula();
+
+private:
+	void CompileFormula();
+	const UCurveTable* LoadCoefficientsTable() const;
+
+	FDDG_DamageFormula CompiledFormula;
+};
@@ -0,0 +1,84 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UCurveTable;
+
+/** Per execution values fed to the damage formula. Captured attributes come from the execution calculation */
+struct FDDG_DamageFormulaInput
+{
+	float BaseDamage = 0.f;
+	float SourceLevel = 1.f;
+	float TargetLevel = 1.f;
+	float TargetHealth = 0.f;
+	float TargetMaxHealth = 0.f;
+	// uniform random value in [0,1) used for crit checks, passed in so batches can be replayed
+	float CritRoll = 0.f;
+};
+
+/**
+ * Damage formula compiled once from text into a small stack bytecode.
+ * Variables are the input fields above plus every "Source.X" / "Target.X" row of the coefficients curve table,
+ * sampled at the source/target level. Evaluating never allocates.
+ *
+ * Supported syntax: numbers, variables, + - * /, unary -, < > (yield 1 or 0), parentheses, min(a,b), max(a,b), clamp(x,lo,hi)
+ */
+class DATADRIVENGAS_API FDDG_DamageFormula
+{
+public:
+	static constexpr int32 MaxStackDepth = 32;
+	static constexpr int32 MaxVariables = 64;
+
+	// Compiles the formula. On error it logs and falls back to plain BaseDamage
+	bool Compile(const FString& Expression, const UCurveTable* CoefficientsTable);
+
+	bool IsCompiled() const { return bCompiled; }
+
+	float Evaluate(const FDDG_DamageFormulaInput& Input) const;
+
+	// Evaluates many executions in parallel, OutDamage must be the same size as Inputs
+	void EvaluateBatch(TArrayView<const FDDG_DamageFormulaInput> Inputs, TArrayView<float> OutDamage, int32 ItemsPerTask = 1024) const;
+
+private:
+	enum class EOp : uint8
+	{
+		PushConst,
+		PushVar,
+		Add,
+		Sub,
+		Mul,
+		Div,
+		Neg,
+		Less,
+		Greater,
+		Min,
+		Max,
+		Clamp,
+	};
+
+	struct FInstruction
+	{
+		EOp Op;
+		uint16 Index;
+		float Value;
+	};
+
+	// coefficient baked per level so evaluation is a plain array read
+	struct FCoefficient
+	{
+		TArray<float> ValuesByLevel;
+		bool bTargetLevel = false;
+	};
+
+	class FParser;
+
+	void BuildVariables(const UCurveTable* CoefficientsTable);
+	void CompileFallback();
+
+	TArray<FInstruction> Code;
+	TArray<FCoefficient> Coefficients;
+	TArray<FName> VariableNames;
+	bool bCompiled = false;
+};
@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+enum class EDDG_JournalEvent : uint8
+{
+	Damage,				// Old = damage done, New = health after
+	DamageIgnoredDead,	// Old = health, New = damage that was ignored because the target is dead
+	Death,				// Old = killing damage
+	LevelUp,			// New = level the stats were applied for
+	AttributeChange,	// Old/New = current value before/after
+	Dropped,			// New = records dropped because the thread's ring buffer was full
+
+	Count
+};
+
+enum class EDDG_JournalAttribute : uint8
+{
+	None,
+	Damage,
+	CharacterLevel,
+	Health,
+	MaxHealth,
+	HealthRegenRate,
+	Mana,
+	MaxMana,
+	ManaRegenRate,
+
+	Count
+};
+
+/** One fixed size journal entry. Written to disk as is, so the layout is the file format */
+struct FDDG_CombatJournalRecord
+{
+	uint64 Cycles;
+	// object serial numbers, never reused within a process and named by the file's name blocks. 0 means none
+	uint32 ObjectId;
+	uint32 InstigatorId;
+	float OldValue;
+	float NewValue;
+	uint16 ThreadIndex;
+	EDDG_JournalEvent EventType;
+	EDDG_JournalAttribute Attribute;
+	// per thread sequence number, gaps mean records are missing from the file
+	uint32 Sequence;
+};
+static_assert(sizeof(FDDG_CombatJournalRecord) == 32, "Combat journal record layout is the file format");
+
+/** Start of every journal file, followed by blocks */
+struct FDDG_CombatJournalHeader
+{
+	static constexpr uint32 ExpectedMagic = 0x4A474444;	// "DDGJ"
+	static constexpr uint16 ExpectedVersion = 2;
+
+	uint32 Magic;
+	uint16 Version;
+	uint16 RecordSize;
+	double SecondsPerCycle;
+	uint64 StartCycles;
+};
+
+enum class EDDG_JournalBlock : uint32
+{
+	Records,	// Count x FDDG_CombatJournalRecord
+	Names,		// Count x (uint32 object id, uint32 byte length, UTF-8 full object name)
+};
+
+/** Precedes every block after the header */
+struct FDDG_CombatJournalBlockHeader
+{
+	EDDG_JournalBlock BlockType;
+	uint32 Count;
+};
+
+/**
+ * Always on binary journal of combat events. Each thread writes to its own lock free ring buffer
+ * and a background thread flushes them to .ddgj files in Saved/Logs, decoded offline by the DDG_CombatJournal commandlet.
+ * Records are dropped instead of blocking when a ring buffer is full.
+ * Objects are identified by their serial number; each thread queues an object's full name the first time it records it,
+ * and the writer flushes those names in a name block ahead of the records using them. Only a thread's first record takes a lock, to register its buffer.
+ */
+class DATADRIVENGAS_API FDDG_CombatJournal
+{
+public:
+	static void Startup();
+	static void Shutdown();
+
+	static void Record(EDDG_JournalEvent EventType, EDDG_JournalAttribute Attribute, const UObject* Object, const UObject* Instigator, float OldValue, float NewValue);
+
+	static const TCHAR* GetEventName(EDDG_JournalEvent EventType);
+	static const TCHAR* GetAttributeName(EDDG_JournalAttribute Attribute);
+
+	static const TCHAR* GetFileExtension() { return TEXT(".ddgj"); }
+};
@@ -0,0 +1,23 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "DDG_CombatJournalCommandlet.generated.h"
+
+/**
+ * Decodes a combat journal and replays it to rebuild each object's attributes.
+ * Usage: -run=DDG_CombatJournal [-File=<journal>] [-Csv=<output csv>]
+ * Without -File the newest journal in Saved/Logs is used.
+ */
+UCLASS()
+class DATADRIVENGAS_API UDDG_CombatJournalCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UDDG_CombatJournalCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};